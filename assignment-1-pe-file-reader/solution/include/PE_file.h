@@ -12,6 +12,8 @@
 #define DDOS_OFFSET 0x3c
 /// Signature ('PE\0\0')
 #define SIGNATURE 0x4550
+/// Section characteristics flag: the section contains uninitialized data
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
 
 #ifdef _MSC_VER
     #pragma pack(push, 1)
@@ -22,7 +22,11 @@ enum program_status {
     /// Error occurred while reading headers
     READ_HEADERS_ERROR,
     /// Error occurred while extracting and writing the section of PE file
-    WRITE_SECTION_ERROR
+    WRITE_SECTION_ERROR,
+    /// Error occurred while collecting section statistics
+    SECTION_STATS_ERROR,
+    /// Error occurred while setting up or running the server
+    SERVER_ERROR
 };
 
 /// @brief Prints the error message to stderr
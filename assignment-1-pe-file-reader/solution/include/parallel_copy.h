@@ -0,0 +1,43 @@
+/// @file
+/// @brief Copying a file range with several concurrent pread/pwrite streams
+
+#ifndef SECTION_EXTRACTOR_PARALLEL_COPY_H
+#define SECTION_EXTRACTOR_PARALLEL_COPY_H
+
+#include <inttypes.h>
+#include <stdio.h>
+
+/// Default number of concurrent copy streams
+#define DEFAULT_COPY_JOBS 4
+
+/// A range is never split into parts smaller than this, so small sections are copied by one stream
+#ifndef MIN_COPY_RANGE_SIZE
+    #define MIN_COPY_RANGE_SIZE (16 * 1024 * 1024)
+#endif
+
+/// Parallel copy result
+enum parallel_copy_status {
+    /// Success
+    COPY_OK = 0,
+    /// Unknown error occurred while reading from the input file
+    COPY_READ_ERROR,
+    /// Unknown error occurred while writing to the output file
+    COPY_WRITE_ERROR,
+    /// The program ran out of memory or couldn't start a thread
+    COPY_NO_RESOURCES,
+    /// Positional I/O is not available on this platform or for these files (e.g. a pipe),
+    /// the caller should fall back to stdio
+    COPY_UNSUPPORTED
+};
+
+/// @brief Copies size bytes at offset of the input file to the beginning of the output file.
+/// The output file is preallocated, the range is split into up to jobs parts copied concurrently
+/// @param[in] in Input file
+/// @param[in] out Output file, must have no buffered data
+/// @param[in] offset Offset of the range in the input file
+/// @param[in] size Size of the range
+/// @param[in] jobs Maximal number of concurrent copy streams
+/// @return The result of copying (COPY_OK or 0 if the copying has been successful)
+enum parallel_copy_status copy_range_parallel(FILE* in, FILE* out, uint64_t offset, uint64_t size, unsigned jobs);
+
+#endif //SECTION_EXTRACTOR_PARALLEL_COPY_H
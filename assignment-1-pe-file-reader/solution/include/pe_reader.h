@@ -38,13 +38,20 @@ enum write_section_status {
 /// @return The result of read (READ_OK or 0 if the read has been successful)
 enum read_pe_result read_headers(FILE* in, struct PEFile* PEFile);
 
+/// @brief Looks for the header of the specified section
+/// @param[in] peFile Structure containing PE file info
+/// @param[in] section_name The name of the section
+/// @return The section header that corresponds to the specified section. NULL if the section hasn't been found
+struct SectionHeader* find_section(char const* section_name, struct PEFile const* peFile);
+
 /// @brief Writes the specified section of PE file to another file.
 /// @param[in] in Input file
 /// @param[in] out Output file
 /// @param[in] PEFile PE file info
 /// @param[in] section_name The name of the section
+/// @param[in] jobs Maximal number of concurrent copy streams for large sections
 /// @return The result of writing the section (WRITE_OK or 0 if the writing has been successful)
-enum write_section_status write_section(FILE* in, FILE* out, struct PEFile* peFile, char* section_name);
+enum write_section_status write_section(FILE* in, FILE* out, struct PEFile* peFile, char* section_name, unsigned jobs);
 
 
 #endif //SECTION_EXTRACTOR_PE_READER_H
@@ -0,0 +1,68 @@
+/// @file
+/// @brief Per-section byte statistics (histogram, entropy, zero runs, size anomalies)
+
+#ifndef SECTION_EXTRACTOR_SECTION_STATS_H
+#define SECTION_EXTRACTOR_SECTION_STATS_H
+
+#include "PE_file.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+/// Minimal length of a zero byte run that is counted by the zero-run ratio
+#define ZERO_RUN_MIN 16
+/// Raw size may exceed the virtual size by this much because of file alignment
+#define RAW_SIZE_SLACK 0x1000
+
+/// Section size anomaly flags
+enum section_anomaly {
+    /// No anomalies
+    ANOMALY_NONE = 0,
+    /// Raw data is larger than the virtual size plus alignment slack
+    ANOMALY_RAW_EXCEEDS_VIRTUAL = 1 << 0,
+    /// Section has a virtual size, but no data on disk, and isn't marked as uninitialized data
+    ANOMALY_NO_RAW_DATA = 1 << 1,
+    /// Raw data range goes beyond the end of file
+    ANOMALY_TRUNCATED = 1 << 2
+};
+
+/// Statistics of a single section
+struct SectionStats {
+    /// Section header the statistics belong to
+    struct SectionHeader const* header;
+    /// Number of occurrences of each byte value
+    uint64_t histogram[256];
+    /// Number of bytes actually read (less than raw size if the section is truncated)
+    uint64_t bytes_read;
+    /// Number of bytes in zero runs of at least ZERO_RUN_MIN bytes
+    uint64_t zero_run_bytes;
+    /// Shannon entropy in bits per byte
+    double entropy;
+    /// Combination of section_anomaly flags
+    unsigned anomalies;
+};
+
+/// Collect section statistics result
+enum stats_status {
+    /// Success
+    STATS_OK = 0,
+    /// The program ran out of memory
+    STATS_NO_MEMORY,
+    /// Unknown error occurred while reading from a file
+    STATS_READ_ERROR
+};
+
+/// @brief Collects statistics of all sections in one pass over the file
+/// @param[in] in Input file
+/// @param[in] peFile PE file info
+/// @param[out] stats Array of header.section_number elements, in section table order
+/// @return The result of collecting (STATS_OK or 0 if it has been successful)
+enum stats_status collect_section_stats(FILE* in, struct PEFile const* peFile, struct SectionStats* stats);
+
+/// @brief Prints a statistics table, one line per section
+/// @param[in] out Output file
+/// @param[in] stats Array of section statistics
+/// @param[in] count Number of sections
+void print_section_stats(FILE* out, struct SectionStats const* stats, size_t count);
+
+#endif //SECTION_EXTRACTOR_SECTION_STATS_H
@@ -0,0 +1,36 @@
+/// @file
+/// @brief Resident extraction server on a Unix domain socket
+///
+/// Requests are single lines with tab-separated fields:
+/// - `GET\t<in_file>\t<section_name>[\t<section_name>...]\n` - for every section the reply is
+///   `OK <size>\n` followed by size bytes of section data, or `ERR <message>\n`
+/// - `FD\t<in_file>\t<section_name>\n` - the reply is `OK <offset> <size>\n` with a read-only descriptor
+///   of the input file attached (SCM_RIGHTS), or `ERR <message>\n`. The descriptor shares its file
+///   position with the server, so it must be read with pread only
+///
+/// Access model: the server reads any file its user can read, on behalf of whoever connects.
+/// So only the server user may connect: the socket is created with mode 0600 and connections
+/// from other users (checked with SO_PEERCRED or getpeereid) are closed right away.
+/// The socket is meant for processes of the same user, not as a privilege boundary
+///
+/// A connection may carry any number of requests. A client that neither sends a request nor
+/// receives reply data for 10 seconds is disconnected, so stalled clients can't hold all the slots.
+/// Opened files and their parsed headers are kept in an LRU cache and reloaded when the file
+/// changes on disk
+
+#ifndef SECTION_EXTRACTOR_SERVER_H
+#define SECTION_EXTRACTOR_SERVER_H
+
+#include <stddef.h>
+
+/// Default number of files kept open by the server
+#define DEFAULT_CACHE_SIZE 64
+
+/// @brief Serves requests on the socket until an unrecoverable error occurs
+/// @param[in] socket_path Path of the Unix domain socket. An existing socket at this path is replaced,
+/// any other existing file makes the server fail
+/// @param[in] cache_size Maximal number of files kept open
+/// @return Program status (SERVER_ERROR), the function doesn't return on success
+int serve(char const* socket_path, size_t cache_size);
+
+#endif //SECTION_EXTRACTOR_SERVER_H
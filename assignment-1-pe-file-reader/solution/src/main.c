@@ -2,10 +2,16 @@
 /// @brief Main application file
 
 #include "error_handler.h"
+#include "parallel_copy.h"
 #include "PE_file.h"
 #include "pe_reader.h"
+#include "section_stats.h"
+#include "server.h"
 
+#include <malloc.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /// Application name string
 #define APP_NAME "section-extractor"
@@ -14,7 +20,77 @@
 /// @param[in] f File to print to (e.g., stdout)
 void usage(FILE *f)
 {
-  fprintf(f, "Usage: " APP_NAME " <in_file> <section_name> <out_file>\n");
+  fprintf(f, "Usage: " APP_NAME " [--jobs <n>] <in_file> <section_name> <out_file>\n");
+  fprintf(f, "       " APP_NAME " --stats <in_file>\n");
+  fprintf(f, "       " APP_NAME " --serve <socket_path> [<cache_size>]\n");
+}
+
+/// @brief Prints entropy, zero-run ratio and size anomalies of every section
+/// @param[in] input_filepath Path to the input file
+/// @return 0 in case of success or error code
+int stats(char* input_filepath)
+{
+  FILE *input = fopen(input_filepath, "rb");
+  if (!input) {
+      print_error("Wrong input path: the second argument must specify a readable file.");
+      return WRONG_INPUT_PATH;
+  }
+
+  struct PEFile peFile = {0};
+
+  if (read_headers(input, &peFile) != READ_OK) {
+      print_error("An error occured while reading PE headers.");
+      fclose(input);
+      return READ_HEADERS_ERROR;
+  }
+
+  // malloc(0) may return NULL, which isn't a lack of memory
+  struct SectionStats* section_stats = NULL;
+  if (peFile.header.section_number) {
+      section_stats = malloc(sizeof(struct SectionStats) * peFile.header.section_number);
+  }
+  if (peFile.header.section_number && !section_stats) {
+      print_error("Not enough free memory to allocate section statistics.");
+      destroy_pe(&peFile);
+      fclose(input);
+      return SECTION_STATS_ERROR;
+  }
+
+  if (collect_section_stats(input, &peFile, section_stats) != STATS_OK) {
+      print_error("Couldn't collect section statistics.");
+      free(section_stats);
+      destroy_pe(&peFile);
+      fclose(input);
+      return SECTION_STATS_ERROR;
+  }
+
+  print_section_stats(stdout, section_stats, peFile.header.section_number);
+
+  free(section_stats);
+  destroy_pe(&peFile);
+
+  if (fclose(input)) {
+      print_error("Couldn't close the input file.");
+      return CLOSE_INPUT_ERROR;
+  }
+
+  return 0;
+}
+
+/// @brief Parses a positive number argument
+/// @param[in] arg Command line argument
+/// @param[in] max Maximal allowed value
+/// @param[out] number Parsed number
+/// @return True if the argument is a positive number not greater than max, false otherwise
+bool parse_positive(char const* arg, unsigned max, unsigned* number)
+{
+  char* end = NULL;
+  unsigned long value = strtoul(arg, &end, 10);
+  if (*arg == '\0' || *end != '\0' || value == 0 || value > max) {
+      return false;
+  }
+  *number = (unsigned) value;
+  return true;
 }
 
 /// @brief Application entry point
@@ -25,6 +101,29 @@ int main(int argc, char** argv)
 {
   (void) argc; (void) argv; // supress 'unused parameters' warning
 
+  if (argc == 3 && !strcmp(argv[1], "--stats")) {
+      return stats(argv[2]);
+  }
+
+  if ((argc == 3 || argc == 4) && !strcmp(argv[1], "--serve")) {
+      unsigned cache_size = DEFAULT_CACHE_SIZE;
+      if (argc == 4 && !parse_positive(argv[3], 65536, &cache_size)) {
+          print_error("Wrong cache size: must be a positive number up to 65536.");
+          return WRONG_NUMBER_OF_ARGS;
+      }
+      return serve(argv[2], cache_size);
+  }
+
+  unsigned jobs = DEFAULT_COPY_JOBS;
+  if (argc == 6 && !strcmp(argv[1], "--jobs")) {
+      if (!parse_positive(argv[2], 1024, &jobs)) {
+          print_error("Wrong number of jobs: must be a positive number up to 1024.");
+          return WRONG_NUMBER_OF_ARGS;
+      }
+      argc -= 2;
+      argv += 2;
+  }
+
   if (argc != 4) {
       usage(stdout);
       return WRONG_NUMBER_OF_ARGS;
@@ -54,7 +153,7 @@ int main(int argc, char** argv)
       return WRONG_OUTPUT_PATH;
   }
 
-  if (write_section(input, output, &peFile, section) != WRITE_OK) {
+  if (write_section(input, output, &peFile, section, jobs) != WRITE_OK) {
       print_error("Couldn't write the section to the file.");
       destroy_pe(&peFile);
       fclose(input);
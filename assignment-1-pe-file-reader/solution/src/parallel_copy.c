@@ -0,0 +1,185 @@
+/// @file
+/// @brief Parallel file range copy implementation (POSIX pread/pwrite and threads)
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "parallel_copy.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Size of the buffer of a single copy stream
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+/// A part of the range copied by one stream
+struct copy_part {
+    /// Input file descriptor
+    int in_fd;
+    /// Output file descriptor
+    int out_fd;
+    /// Offset of the part in the input file
+    uint64_t in_offset;
+    /// Offset of the part in the output file
+    uint64_t out_offset;
+    /// Size of the part
+    uint64_t size;
+    /// Result of copying the part
+    enum parallel_copy_status status;
+};
+
+/// @brief Writes the whole buffer at the offset, retrying on short writes
+/// @param[in] fd Output file descriptor
+/// @param[in] buffer Data
+/// @param[in] size Size of the data
+/// @param[in] offset Offset in the output file
+/// @return True if the write has been successful, false if an error occurred
+static bool pwrite_all(int fd, char const* buffer, size_t size, uint64_t offset) {
+    while (size) {
+        ssize_t written = pwrite(fd, buffer, size, (off_t) offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buffer += written;
+        size -= (size_t) written;
+        offset += (uint64_t) written;
+    }
+    return true;
+}
+
+/// @brief Copies one part of the range (thread routine)
+/// @param[in,out] arg Pointer to the copy_part structure
+/// @return NULL
+static void* copy_part(void* arg) {
+    struct copy_part* part = arg;
+    char* buffer = malloc(COPY_BUFFER_SIZE);
+    if (!buffer) {
+        part->status = COPY_NO_RESOURCES;
+        return NULL;
+    }
+    part->status = COPY_OK;
+    uint64_t done = 0;
+    while (done < part->size) {
+        uint64_t left = part->size - done;
+        size_t chunk = left < COPY_BUFFER_SIZE ? (size_t) left : COPY_BUFFER_SIZE;
+        ssize_t got = pread(part->in_fd, buffer, chunk, (off_t) (part->in_offset + done));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        // ESPIPE: the file can't be read or written by offset, the caller falls back to stdio
+        if (got <= 0) {
+            part->status = got < 0 && errno == ESPIPE ? COPY_UNSUPPORTED : COPY_READ_ERROR;
+            break;
+        }
+        if (!pwrite_all(part->out_fd, buffer, (size_t) got, part->out_offset + done)) {
+            part->status = errno == ESPIPE ? COPY_UNSUPPORTED : COPY_WRITE_ERROR;
+            break;
+        }
+        done += (uint64_t) got;
+    }
+    free(buffer);
+    return NULL;
+}
+
+/// @brief Checks if the descriptor refers to a regular file, which supports pread/pwrite
+/// @param[in] fd File descriptor
+/// @return True if the file is a regular file
+static bool is_regular_file(int fd) {
+    struct stat st;
+    return fd >= 0 && !fstat(fd, &st) && S_ISREG(st.st_mode);
+}
+
+/// @brief Copies size bytes at offset of the input file to the beginning of the output file.
+/// The output file is preallocated, the range is split into up to jobs parts copied concurrently
+/// @param[in] in Input file
+/// @param[in] out Output file, must have no buffered data
+/// @param[in] offset Offset of the range in the input file
+/// @param[in] size Size of the range
+/// @param[in] jobs Maximal number of concurrent copy streams
+/// @return The result of copying (COPY_OK or 0 if the copying has been successful)
+enum parallel_copy_status copy_range_parallel(FILE* in, FILE* out, uint64_t offset, uint64_t size, unsigned jobs) {
+    int in_fd = fileno(in);
+    int out_fd = fileno(out);
+    // Pipes, terminals and sockets have no offsets, e.g. when the output is /dev/stdout
+    if (!is_regular_file(in_fd) || !is_regular_file(out_fd)) {
+        return COPY_UNSUPPORTED;
+    }
+
+#ifdef __linux__
+    // Best effort: the copy works without preallocation, just with more fragmentation
+    if (size) {
+        (void) fallocate(out_fd, 0, 0, (off_t) size);
+    }
+#endif
+
+    uint64_t max_parts = size / MIN_COPY_RANGE_SIZE;
+    size_t parts_number = jobs < max_parts ? jobs : (size_t) max_parts;
+    if (parts_number < 1) {
+        parts_number = 1;
+    }
+
+    struct copy_part* parts = malloc(sizeof(struct copy_part) * parts_number);
+    pthread_t* threads = malloc(sizeof(pthread_t) * parts_number);
+    if (!parts || !threads) {
+        free(parts);
+        free(threads);
+        return COPY_NO_RESOURCES;
+    }
+
+    uint64_t part_size = size / parts_number;
+    for (size_t i = 0; i < parts_number; i++) {
+        parts[i] = (struct copy_part) {
+            .in_fd = in_fd,
+            .out_fd = out_fd,
+            .in_offset = offset + part_size * i,
+            .out_offset = part_size * i,
+            .size = i + 1 == parts_number ? size - part_size * i : part_size
+        };
+    }
+
+    // The calling thread copies the first part itself, as well as the parts
+    // it couldn't start a thread for
+    size_t started = 1;
+    for (; started < parts_number; started++) {
+        if (pthread_create(&threads[started], NULL, copy_part, &parts[started])) {
+            break;
+        }
+    }
+    copy_part(&parts[0]);
+    for (size_t i = started; i < parts_number; i++) {
+        copy_part(&parts[i]);
+    }
+
+    enum parallel_copy_status status = COPY_OK;
+    for (size_t i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (size_t i = 0; i < parts_number && status == COPY_OK; i++) {
+        status = parts[i].status;
+    }
+
+    free(parts);
+    free(threads);
+    return status;
+}
+
+#else
+
+/// @brief Stub for platforms without positional I/O
+/// @return COPY_UNSUPPORTED
+enum parallel_copy_status copy_range_parallel(FILE* in, FILE* out, uint64_t offset, uint64_t size, unsigned jobs) {
+    (void) in; (void) out; (void) offset; (void) size; (void) jobs;
+    return COPY_UNSUPPORTED;
+}
+
+#endif
@@ -2,6 +2,7 @@
 /// @brief PE headers reader and section extractor implementation
 
 #include "error_handler.h"
+#include "parallel_copy.h"
 #include "PE_file.h"
 #include "pe_reader.h"
 
@@ -67,7 +68,8 @@ bool read_section_headers(FILE * in, struct PEFile* peFile) {
         free(peFile->section_headers);
         return false;
     }
-    if (fread(peFile->section_headers, section_headers_size, 1, in) != 1) {
+    // A file without sections has nothing to read, fread() would report it as a failure
+    if (section_headers_size && fread(peFile->section_headers, section_headers_size, 1, in) != 1) {
         free(peFile->section_headers);
         return false;
     }
@@ -104,7 +106,7 @@ enum read_pe_result read_headers(FILE* in, struct PEFile* PEFile) {
 /// @param[in] peFile Structure containing PE file info
 /// @param[in] section_name The name of the section
 /// @return The section header that corresponds to the specified section. NULL if the section hasn't been found
-static inline struct SectionHeader* find_section(char const* section_name, struct PEFile const* peFile) {
+struct SectionHeader* find_section(char const* section_name, struct PEFile const* peFile) {
     for (size_t i = 0; i < peFile->header.section_number; i++) {
         if (!strcmp(peFile->section_headers[i].section_name, section_name)) {
             return &peFile->section_headers[i];
@@ -134,18 +136,43 @@ static inline bool read_section_data(struct SectionHeader* sectionHeader, char*
     return fread(section_data, sectionHeader->raw_data_size, 1, in) == 1;
 }
 
+/// @brief Converts the result of the parallel copy to the write section status
+/// @param[in] status Parallel copy result, not COPY_UNSUPPORTED
+/// @return The result of writing the section
+static enum write_section_status copy_to_write_status(enum parallel_copy_status status) {
+    switch (status) {
+        case COPY_OK:
+            return WRITE_OK;
+        case COPY_READ_ERROR:
+            print_error("Read section data error.");
+            return READ_SECTION_ERROR;
+        case COPY_WRITE_ERROR:
+            print_error("Write section data error.");
+            return WRITE_ERROR;
+        default:
+            print_error("Not enough resources to copy section data.");
+            return NO_MEMORY;
+    }
+}
+
 /// @brief Writes the specified section of PE file to another file.
 /// @param[in] in Input file
 /// @param[in] out Output file
 /// @param[in] PEFile PE file info
 /// @param[in] section_name The name of the section
+/// @param[in] jobs Maximal number of concurrent copy streams for large sections
 /// @return The result of writing the section (WRITE_OK or 0 if the writing has been successful)
-enum write_section_status write_section(FILE* in, FILE* out, struct PEFile* peFile, char* section_name) {
+enum write_section_status write_section(FILE* in, FILE* out, struct PEFile* peFile, char* section_name, unsigned jobs) {
     struct SectionHeader* section_header = find_section(section_name, peFile);
     if (!section_header) {
         print_error("No section with this name found.");
         return NO_SUCH_SECTION;
     }
+    enum parallel_copy_status copy_status = copy_range_parallel(in, out, section_header->raw_data_ptr, section_header->raw_data_size, jobs);
+    if (copy_status != COPY_UNSUPPORTED) {
+        return copy_to_write_status(copy_status);
+    }
+    // No positional I/O on this platform or for these files, copy through a single buffer
     char* section_data = malloc(section_header->raw_data_size);
     if (!section_data) {
         print_error("Not enough free memory to allocate section data.");
@@ -0,0 +1,277 @@
+/// @file
+/// @brief Per-section byte statistics implementation
+
+#include "PE_file.h"
+#include "section_stats.h"
+
+#include <malloc.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Size of a chunk read from the file at once. Small enough for 32-bit partial histogram counters
+#define CHUNK_SIZE (64 * 1024)
+
+/// Number of interleaved partial histograms used by the histogram kernel
+#define HISTOGRAM_LANES 4
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    /// Number of bytes checked at once by the zero run kernel
+    #define ZERO_BLOCK_SIZE 16
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    /// Number of bytes checked at once by the zero run kernel
+    #define ZERO_BLOCK_SIZE 16
+#else
+    /// Number of bytes checked at once by the zero run kernel
+    #define ZERO_BLOCK_SIZE 8
+#endif
+
+/// @brief Adds byte counts of a buffer to the histogram.
+/// Scalar kernel: a histogram is a scatter of increments, which SSE2/NEON can't do.
+/// Bytes are loaded a 64-bit word at a time and spread over several partial histograms,
+/// so consecutive equal bytes don't serialize on the same counter
+/// @param[in] data Buffer
+/// @param[in] size Buffer size, at most CHUNK_SIZE
+/// @param[in,out] histogram Histogram to add to
+static void histogram_update(unsigned char const* data, size_t size, uint64_t* histogram) {
+    uint32_t lanes[HISTOGRAM_LANES][256] = {0};
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        lanes[0][word & 0xff]++;
+        lanes[1][(word >> 8) & 0xff]++;
+        lanes[2][(word >> 16) & 0xff]++;
+        lanes[3][(word >> 24) & 0xff]++;
+        lanes[0][(word >> 32) & 0xff]++;
+        lanes[1][(word >> 40) & 0xff]++;
+        lanes[2][(word >> 48) & 0xff]++;
+        lanes[3][word >> 56]++;
+    }
+    for (; i < size; i++) {
+        lanes[0][data[i]]++;
+    }
+    for (size_t b = 0; b < 256; b++) {
+        histogram[b] += (uint64_t) lanes[0][b] + lanes[1][b] + lanes[2][b] + lanes[3][b];
+    }
+}
+
+/// @brief Accounts a finished zero run
+/// @param[in,out] stats Section statistics
+/// @param[in,out] run Length of the run, reset to 0
+static inline void zero_run_end(struct SectionStats* stats, uint64_t* run) {
+    if (*run >= ZERO_RUN_MIN) {
+        stats->zero_run_bytes += *run;
+    }
+    *run = 0;
+}
+
+/// @brief Checks if a block of ZERO_BLOCK_SIZE bytes is all zero, with SSE2 or NEON when available
+/// @param[in] data Block
+/// @return True if all bytes of the block are zero
+static inline bool zero_block(unsigned char const* data) {
+#if defined(__SSE2__)
+    __m128i block = _mm_loadu_si128((__m128i const*) data);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128())) == 0xffff;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return vmaxvq_u8(vld1q_u8(data)) == 0;
+#else
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return !word;
+#endif
+}
+
+/// @brief Counts bytes in long zero runs, skipping all-zero blocks at once
+/// @param[in] data Buffer
+/// @param[in] size Buffer size
+/// @param[in,out] stats Section statistics
+/// @param[in,out] run Length of the zero run continuing from the previous buffer
+static void zero_runs_update(unsigned char const* data, size_t size, struct SectionStats* stats, uint64_t* run) {
+    size_t i = 0;
+    while (i < size) {
+        if (i + ZERO_BLOCK_SIZE <= size && zero_block(data + i)) {
+            *run += ZERO_BLOCK_SIZE;
+            i += ZERO_BLOCK_SIZE;
+            continue;
+        }
+        if (data[i]) {
+            zero_run_end(stats, run);
+        } else {
+            (*run)++;
+        }
+        i++;
+    }
+}
+
+/// @brief Computes Shannon entropy of the histogram
+/// @param[in] stats Section statistics
+/// @return Entropy in bits per byte
+static double entropy(struct SectionStats const* stats) {
+    if (!stats->bytes_read) {
+        return 0;
+    }
+    double res = 0;
+    for (size_t b = 0; b < 256; b++) {
+        if (stats->histogram[b]) {
+            double p = (double) stats->histogram[b] / (double) stats->bytes_read;
+            res -= p * log2(p);
+        }
+    }
+    return res;
+}
+
+/// @brief Detects raw versus virtual size anomalies
+/// @param[in] header Section header
+/// @param[in] file_size Size of the input file
+/// @return Combination of section_anomaly flags
+static unsigned detect_anomalies(struct SectionHeader const* header, uint64_t file_size) {
+    unsigned res = ANOMALY_NONE;
+    if (header->section_virtual_size && header->raw_data_size > (uint64_t) header->section_virtual_size + RAW_SIZE_SLACK) {
+        res |= ANOMALY_RAW_EXCEEDS_VIRTUAL;
+    }
+    // Uninitialized data (.bss) has no data on disk by design
+    if (header->section_virtual_size && !header->raw_data_size
+        && !(header->characteristics & IMAGE_SCN_CNT_UNINITIALIZED_DATA)) {
+        res |= ANOMALY_NO_RAW_DATA;
+    }
+    if ((uint64_t) header->raw_data_ptr + header->raw_data_size > file_size) {
+        res |= ANOMALY_TRUNCATED;
+    }
+    return res;
+}
+
+/// @brief Clips the raw data range of the section to the end of file
+/// @param[in] header Section header
+/// @param[in] file_size Size of the input file
+/// @return Number of section bytes actually present in the file
+static inline uint64_t clip_to_file(struct SectionHeader const* header, uint64_t file_size) {
+    if (header->raw_data_ptr >= file_size) {
+        return 0;
+    }
+    uint64_t available = file_size - header->raw_data_ptr;
+    return header->raw_data_size < available ? header->raw_data_size : available;
+}
+
+/// @brief Compares section statistics by the file offset of section data (for qsort)
+static int compare_by_raw_ptr(void const* a, void const* b) {
+    uint32_t ptr_a = (*(struct SectionStats* const*) a)->header->raw_data_ptr;
+    uint32_t ptr_b = (*(struct SectionStats* const*) b)->header->raw_data_ptr;
+    return (ptr_a > ptr_b) - (ptr_a < ptr_b);
+}
+
+/// @brief Gets the size of the file
+/// @param[in] in Input file
+/// @param[out] size File size
+/// @return True if the size has been determined, false if an error occurred
+static bool file_size(FILE* in, uint64_t* size) {
+    if (fseek(in, 0, SEEK_END)) {
+        return false;
+    }
+    long pos = ftell(in);
+    if (pos < 0) {
+        return false;
+    }
+    *size = (uint64_t) pos;
+    return true;
+}
+
+/// @brief Reads the section data chunk by chunk and updates its statistics
+/// @param[in] in Input file
+/// @param[in,out] stats Section statistics
+/// @param[in] size Number of bytes to read (raw size clipped to the end of file)
+/// @param[in] buffer Buffer of CHUNK_SIZE bytes
+/// @return True if the read has been successful, false if an error occurred
+static bool scan_section(FILE* in, struct SectionStats* stats, uint64_t size, unsigned char* buffer) {
+    if (fseek(in, (long) stats->header->raw_data_ptr, SEEK_SET)) {
+        return false;
+    }
+    uint64_t run = 0;
+    while (stats->bytes_read < size) {
+        uint64_t left = size - stats->bytes_read;
+        size_t chunk = left < CHUNK_SIZE ? (size_t) left : CHUNK_SIZE;
+        if (fread(buffer, chunk, 1, in) != 1) {
+            return false;
+        }
+        histogram_update(buffer, chunk, stats->histogram);
+        zero_runs_update(buffer, chunk, stats, &run);
+        stats->bytes_read += chunk;
+    }
+    zero_run_end(stats, &run);
+    return true;
+}
+
+/// @brief Collects statistics of all sections in one pass over the file
+/// @param[in] in Input file
+/// @param[in] peFile PE file info
+/// @param[out] stats Array of header.section_number elements, in section table order
+/// @return The result of collecting (STATS_OK or 0 if it has been successful)
+enum stats_status collect_section_stats(FILE* in, struct PEFile const* peFile, struct SectionStats* stats) {
+    size_t count = peFile->header.section_number;
+    if (!count) {
+        return STATS_OK;
+    }
+    uint64_t size = 0;
+    if (!file_size(in, &size)) {
+        return STATS_READ_ERROR;
+    }
+
+    struct SectionStats** order = malloc(sizeof(struct SectionStats*) * count);
+    unsigned char* buffer = malloc(CHUNK_SIZE);
+    if (!order || !buffer) {
+        free(order);
+        free(buffer);
+        return STATS_NO_MEMORY;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        stats[i] = (struct SectionStats) {.header = &peFile->section_headers[i]};
+        stats[i].anomalies = detect_anomalies(stats[i].header, size);
+        order[i] = &stats[i];
+    }
+    // Visit sections in file order, so the whole file is read front to back once
+    qsort(order, count, sizeof(struct SectionStats*), compare_by_raw_ptr);
+
+    enum stats_status status = STATS_OK;
+    for (size_t i = 0; i < count; i++) {
+        if (!scan_section(in, order[i], clip_to_file(order[i]->header, size), buffer)) {
+            status = STATS_READ_ERROR;
+            break;
+        }
+        order[i]->entropy = entropy(order[i]);
+    }
+
+    free(order);
+    free(buffer);
+    return status;
+}
+
+/// @brief Prints a statistics table, one line per section
+/// @param[in] out Output file
+/// @param[in] stats Array of section statistics
+/// @param[in] count Number of sections
+void print_section_stats(FILE* out, struct SectionStats const* stats, size_t count) {
+    fprintf(out, "%-8s %10s %10s %10s %8s %8s  %s\n", "Name", "RawPtr", "RawSize", "VirtSize", "Entropy", "Zeros", "Anomalies");
+    for (size_t i = 0; i < count; i++) {
+        struct SectionHeader const* header = stats[i].header;
+        double zero_ratio = stats[i].bytes_read ? (double) stats[i].zero_run_bytes / (double) stats[i].bytes_read : 0;
+        fprintf(out, "%-8.8s 0x%08" PRIx32 " %10" PRIu32 " %10" PRIu32 " %8.4f %7.2f%% ",
+                header->section_name, header->raw_data_ptr, header->raw_data_size, header->section_virtual_size,
+                stats[i].entropy, zero_ratio * 100);
+        if (stats[i].anomalies == ANOMALY_NONE) {
+            fprintf(out, " -");
+        }
+        if (stats[i].anomalies & ANOMALY_RAW_EXCEEDS_VIRTUAL) {
+            fprintf(out, " raw>virtual");
+        }
+        if (stats[i].anomalies & ANOMALY_NO_RAW_DATA) {
+            fprintf(out, " no-raw-data");
+        }
+        if (stats[i].anomalies & ANOMALY_TRUNCATED) {
+            fprintf(out, " truncated");
+        }
+        fprintf(out, "\n");
+    }
+}
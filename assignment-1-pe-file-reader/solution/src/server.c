@@ -0,0 +1,833 @@
+/// @file
+/// @brief Resident extraction server implementation
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "error_handler.h"
+#include "PE_file.h"
+#include "pe_reader.h"
+#include "server.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Maximal number of simultaneously connected clients
+#define MAX_CLIENTS 64
+/// Maximal length of a request line
+#define REQUEST_MAX_SIZE 4096
+/// Maximal number of sections in a single GET request
+#define MAX_REQUEST_SECTIONS 16
+/// Size of the buffer used to send section data
+#define SEND_BUFFER_SIZE (256 * 1024)
+/// Maximal length of a reply status line
+#define REPLY_TEXT_SIZE 80
+/// A client that neither sends nor receives anything for this long is disconnected,
+/// so stalled or idle connections can't hold all the client slots
+#ifndef CLIENT_TIMEOUT_MS
+    #define CLIENT_TIMEOUT_MS 10000
+#endif
+/// Descriptors not available to the file cache: standard streams, the listening socket,
+/// and a socket plus an input file duplicate for every client
+#define RESERVED_FDS (2 * MAX_CLIENTS + 8)
+
+#ifdef __APPLE__
+    /// Modification time of struct stat with nanoseconds
+    #define STAT_MTIME(st) ((st)->st_mtimespec)
+#else
+    /// Modification time of struct stat with nanoseconds
+    #define STAT_MTIME(st) ((st)->st_mtim)
+#endif
+
+/// Opened input file with parsed headers
+struct CachedFile {
+    /// Path the file was requested by
+    char* path;
+    /// Opened file
+    FILE* file;
+    /// Parsed headers
+    struct PEFile peFile;
+    /// @name File identity, used to detect changes on disk
+    ///@{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    ///@}
+    /// Hash of the path
+    uint64_t hash;
+    /// Next entry in the same hash bucket, or in the free list for unused entries
+    struct CachedFile* bucket_next;
+    /// @name Neighbours in the LRU list
+    ///@{
+    struct CachedFile* newer;
+    struct CachedFile* older;
+    ///@}
+};
+
+/// LRU cache of opened files: a hash table by path for lookups,
+/// and a list from the most to the least recently used entry for evictions
+struct FileCache {
+    /// Array of capacity entries, allocated once
+    struct CachedFile* entries;
+    /// Unused entries, linked through bucket_next
+    struct CachedFile* free;
+    /// Hash table of used entries, a power of two of buckets
+    struct CachedFile** buckets;
+    /// Number of buckets
+    size_t buckets_number;
+    /// Most recently used entry
+    struct CachedFile* newest;
+    /// Least recently used entry, the next one to evict
+    struct CachedFile* oldest;
+    /// Maximal number of entries
+    size_t capacity;
+    /// Number of used entries
+    size_t count;
+};
+
+/// A part of a reply: a status line, followed by section data for successful GET requests
+struct ReplyPart {
+    /// Status line
+    char text[REPLY_TEXT_SIZE];
+    /// Length of the status line
+    size_t text_size;
+    /// Offset of the section data in the input file
+    uint64_t data_offset;
+    /// Size of the section data, 0 if the part has no data
+    uint64_t data_size;
+};
+
+/// Connected client
+struct Client {
+    /// Socket, non-blocking
+    int fd;
+    /// Number of bytes in the request buffer
+    size_t used;
+    /// Incomplete request data
+    char request[REQUEST_MAX_SIZE];
+    /// Monotonic time of the last data received from or sent to the client, in milliseconds
+    uint64_t last_progress;
+
+    /// @name Reply being sent. Further requests aren't read until it has been sent completely
+    ///@{
+
+    /// Parts of the reply, one per requested section
+    struct ReplyPart parts[MAX_REQUEST_SECTIONS];
+    /// Number of parts
+    size_t parts_number;
+    /// Part being sent
+    size_t current_part;
+    /// Number of bytes of the current status line sent
+    size_t text_sent;
+    /// Number of bytes of the current section data sent
+    uint64_t data_sent;
+    /// Duplicate of the input file descriptor, so the cache may evict the file meanwhile. -1 if not needed
+    int input_fd;
+    /// Whether input_fd is passed to the client with the first byte of the reply
+    bool pass_input_fd;
+    /// Whether the connection is closed once the reply has been sent
+    bool close_after_reply;
+    ///@}
+};
+
+/// Result of sending the pending reply
+enum flush_result {
+    /// The reply has been sent completely
+    FLUSH_DONE = 0,
+    /// The socket buffer is full, the rest is sent when the socket becomes writable
+    FLUSH_PENDING,
+    /// The connection is broken
+    FLUSH_ERROR
+};
+
+/// @brief Closes the file and frees the headers of a cache entry
+/// @param[in] entry Cache entry
+static void release_entry(struct CachedFile* entry) {
+    destroy_pe(&entry->peFile);
+    fclose(entry->file);
+    free(entry->path);
+}
+
+/// @brief Checks if the cache entry still corresponds to the file on disk
+/// @param[in] entry Cache entry
+/// @param[in] st Current file status
+/// @return True if the file hasn't changed
+static inline bool entry_is_fresh(struct CachedFile const* entry, struct stat const* st) {
+    return entry->dev == st->st_dev && entry->ino == st->st_ino && entry->size == st->st_size
+        && entry->mtime.tv_sec == STAT_MTIME(st).tv_sec && entry->mtime.tv_nsec == STAT_MTIME(st).tv_nsec;
+}
+
+/// @brief Opens the file and reads its headers into a new cache entry
+/// @param[out] entry Cache entry
+/// @param[in] path Path to the file
+/// @param[in] st File status
+/// @return True if the file has been loaded, false if an error occurred (errno is set)
+static bool load_entry(struct CachedFile* entry, char const* path, struct stat const* st) {
+    struct CachedFile loaded = {
+        .dev = st->st_dev, .ino = st->st_ino, .size = st->st_size, .mtime = STAT_MTIME(st)
+    };
+    loaded.file = fopen(path, "rb");
+    if (!loaded.file) {
+        return false;
+    }
+    if (read_headers(loaded.file, &loaded.peFile) != READ_OK) {
+        fclose(loaded.file);
+        errno = EINVAL;
+        return false;
+    }
+    loaded.path = strdup(path);
+    if (!loaded.path) {
+        destroy_pe(&loaded.peFile);
+        fclose(loaded.file);
+        errno = ENOMEM;
+        return false;
+    }
+    *entry = loaded;
+    return true;
+}
+
+/// @brief Computes the FNV-1a hash of the path
+/// @param[in] path Path
+/// @return Hash
+static uint64_t path_hash(char const* path) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *path; path++) {
+        hash = (hash ^ (unsigned char) *path) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/// @brief Allocates the entries and the hash table of the cache
+/// @param[out] cache File cache
+/// @param[in] capacity Maximal number of entries
+/// @return True if the cache has been created, false if there is not enough memory
+static bool cache_init(struct FileCache* cache, size_t capacity) {
+    *cache = (struct FileCache) {.capacity = capacity, .buckets_number = 1};
+    // At most half of the buckets are used, so the chains stay short
+    while (cache->buckets_number < capacity * 2) {
+        cache->buckets_number *= 2;
+    }
+    cache->entries = malloc(sizeof(struct CachedFile) * capacity);
+    cache->buckets = calloc(cache->buckets_number, sizeof(struct CachedFile*));
+    if (!cache->entries || !cache->buckets) {
+        free(cache->entries);
+        free(cache->buckets);
+        return false;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        cache->entries[i].bucket_next = i + 1 < capacity ? &cache->entries[i + 1] : NULL;
+    }
+    cache->free = cache->entries;
+    return true;
+}
+
+/// @brief Releases all entries and frees the cache
+/// @param[in] cache File cache
+static void cache_destroy(struct FileCache* cache) {
+    for (struct CachedFile* entry = cache->newest; entry; entry = entry->older) {
+        release_entry(entry);
+    }
+    free(cache->entries);
+    free(cache->buckets);
+}
+
+/// @brief Gets the hash bucket of the path
+/// @param[in] cache File cache
+/// @param[in] hash Hash of the path
+/// @return Pointer to the head of the bucket chain
+static inline struct CachedFile** bucket_of(struct FileCache* cache, uint64_t hash) {
+    return &cache->buckets[hash & (cache->buckets_number - 1)];
+}
+
+/// @brief Unlinks the entry from the LRU list
+/// @param[in] cache File cache
+/// @param[in] entry Cache entry
+static void lru_unlink(struct FileCache* cache, struct CachedFile* entry) {
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+/// @brief Puts the entry at the most recently used end of the LRU list
+/// @param[in] cache File cache
+/// @param[in] entry Cache entry, not in the list
+static void lru_push(struct FileCache* cache, struct CachedFile* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+/// @brief Releases the cache entry and returns it to the free list
+/// @param[in] cache File cache
+/// @param[in] entry Cache entry
+static void remove_entry(struct FileCache* cache, struct CachedFile* entry) {
+    struct CachedFile** link = bucket_of(cache, entry->hash);
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+    lru_unlink(cache, entry);
+    release_entry(entry);
+
+    entry->bucket_next = cache->free;
+    cache->free = entry;
+    cache->count--;
+}
+
+/// @brief Removes the least recently used entry
+/// @param[in] cache File cache, must not be empty
+static void evict_lru(struct FileCache* cache) {
+    remove_entry(cache, cache->oldest);
+}
+
+/// @brief Finds the file in the cache or loads it, evicting the least recently used entries
+/// when the cache is full or the process runs out of descriptors
+/// @param[in] cache File cache
+/// @param[in] path Path to the file
+/// @return Cache entry, NULL if the file couldn't be loaded
+static struct CachedFile* cache_get(struct FileCache* cache, char const* path) {
+    struct stat st;
+    if (stat(path, &st)) {
+        return NULL;
+    }
+    uint64_t hash = path_hash(path);
+
+    for (struct CachedFile* entry = *bucket_of(cache, hash); entry; entry = entry->bucket_next) {
+        if (entry->hash == hash && !strcmp(entry->path, path)) {
+            if (entry_is_fresh(entry, &st)) {
+                lru_unlink(cache, entry);
+                lru_push(cache, entry);
+                return entry;
+            }
+            remove_entry(cache, entry);
+            break;
+        }
+    }
+    if (cache->count == cache->capacity) {
+        evict_lru(cache);
+    }
+
+    struct CachedFile loaded;
+    while (!load_entry(&loaded, path, &st)) {
+        if ((errno != EMFILE && errno != ENFILE) || !cache->count) {
+            return NULL;
+        }
+        evict_lru(cache);
+    }
+    struct CachedFile* entry = cache->free;
+    cache->free = entry->bucket_next;
+    cache->count++;
+
+    *entry = loaded;
+    entry->hash = hash;
+    struct CachedFile** bucket = bucket_of(cache, hash);
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    lru_push(cache, entry);
+    return entry;
+}
+
+/// @brief Limits the cache size, so the cached files together with the clients fit into the open files limit
+/// @param[in] cache_size Requested cache size
+/// @return Cache size to use, at least 1
+static size_t limit_cache_size(size_t cache_size) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) || limit.rlim_cur == RLIM_INFINITY) {
+        return cache_size;
+    }
+    size_t available = limit.rlim_cur > RESERVED_FDS ? (size_t) (limit.rlim_cur - RESERVED_FDS) : 1;
+    if (available < cache_size) {
+        fprintf(stderr, "Cache size limited to %zu by the open files limit.\n", available);
+        return available;
+    }
+    return cache_size;
+}
+
+/// @brief Gets the monotonic time
+/// @return Milliseconds since an unspecified point
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+/// @brief Drops the reply of the client and closes the input file duplicate
+/// @param[in] client Client
+static void reply_reset(struct Client* client) {
+    if (client->input_fd >= 0) {
+        close(client->input_fd);
+    }
+    client->parts_number = 0;
+    client->current_part = 0;
+    client->text_sent = 0;
+    client->data_sent = 0;
+    client->input_fd = -1;
+    client->pass_input_fd = false;
+}
+
+/// @brief Checks if the client has a reply that hasn't been sent completely
+/// @param[in] client Client
+/// @return True if a reply is pending
+static inline bool reply_pending(struct Client const* client) {
+    return client->current_part < client->parts_number;
+}
+
+/// @brief Appends a part to the reply
+/// @param[in] client Client
+/// @param[in] text Status line
+/// @param[in] data_offset Offset of the section data in the input file
+/// @param[in] data_size Size of the section data, 0 for no data
+static void reply_add(struct Client* client, char const* text, uint64_t data_offset, uint64_t data_size) {
+    struct ReplyPart* part = &client->parts[client->parts_number++];
+    int size = snprintf(part->text, sizeof(part->text), "%s", text);
+    part->text_size = (size_t) size < sizeof(part->text) ? (size_t) size : sizeof(part->text) - 1;
+    part->data_offset = data_offset;
+    part->data_size = data_size;
+}
+
+/// @brief Appends an error part to the reply
+/// @param[in] client Client
+/// @param[in] message Error message
+static void reply_error(struct Client* client, char const* message) {
+    char text[REPLY_TEXT_SIZE];
+    snprintf(text, sizeof(text), "ERR %s\n", message);
+    reply_add(client, text, 0, 0);
+}
+
+/// @brief Checks if the section data lies within the file
+/// @param[in] entry Cache entry
+/// @param[in] header Section header
+/// @return True if the whole raw data range is present in the file
+static inline bool section_in_file(struct CachedFile const* entry, struct SectionHeader const* header) {
+    return (uint64_t) header->raw_data_ptr + header->raw_data_size <= (uint64_t) entry->size;
+}
+
+/// @brief Looks up the section and checks its bounds, appending an error part if it can't be served
+/// @param[in] client Client
+/// @param[in] entry Cache entry
+/// @param[in] section_name The name of the section
+/// @return Section header, NULL if an error part has been appended
+static struct SectionHeader const* reply_find_section(struct Client* client, struct CachedFile const* entry, char const* section_name) {
+    struct SectionHeader const* header = find_section(section_name, &entry->peFile);
+    if (!header) {
+        reply_error(client, "No section with this name found.");
+        return NULL;
+    }
+    if (!section_in_file(entry, header)) {
+        reply_error(client, "Section data is out of file bounds.");
+        return NULL;
+    }
+    return header;
+}
+
+/// @brief Parses a request line and prepares the reply
+/// @param[in] client Client, must have no pending reply
+/// @param[in] cache File cache
+/// @param[in] line Request line without the trailing newline, modified in place
+static void start_request(struct Client* client, struct FileCache* cache, char* line) {
+    reply_reset(client);
+    char* fields[2 + MAX_REQUEST_SECTIONS];
+    size_t fields_number = 0;
+    for (char* field = line; field; fields_number++) {
+        if (fields_number == 2 + MAX_REQUEST_SECTIONS) {
+            reply_error(client, "Too many sections in the request.");
+            return;
+        }
+        fields[fields_number] = field;
+        field = strchr(field, '\t');
+        if (field) {
+            *field++ = '\0';
+        }
+    }
+    if (fields_number < 3) {
+        reply_error(client, "Malformed request.");
+        return;
+    }
+    bool is_get = !strcmp(fields[0], "GET");
+    bool is_fd = !strcmp(fields[0], "FD");
+    if (!is_get && !(is_fd && fields_number == 3)) {
+        reply_error(client, "Malformed request.");
+        return;
+    }
+
+    struct CachedFile* entry = cache_get(cache, fields[1]);
+    if (!entry) {
+        reply_error(client, "Couldn't open the file or read PE headers.");
+        return;
+    }
+    client->input_fd = dup(fileno(entry->file));
+    if (client->input_fd < 0) {
+        reply_error(client, "Server is out of file descriptors.");
+        return;
+    }
+
+    char text[REPLY_TEXT_SIZE];
+    if (is_fd) {
+        struct SectionHeader const* header = reply_find_section(client, entry, fields[2]);
+        if (header) {
+            snprintf(text, sizeof(text), "OK %" PRIu32 " %" PRIu32 "\n", header->raw_data_ptr, header->raw_data_size);
+            reply_add(client, text, 0, 0);
+            client->pass_input_fd = true;
+        }
+        return;
+    }
+    for (size_t i = 2; i < fields_number; i++) {
+        struct SectionHeader const* header = reply_find_section(client, entry, fields[i]);
+        if (header) {
+            snprintf(text, sizeof(text), "OK %" PRIu32 "\n", header->raw_data_size);
+            reply_add(client, text, header->raw_data_ptr, header->raw_data_size);
+        }
+    }
+}
+
+/// @brief Sends a part of the status line, attaching the input file descriptor if it has to be passed
+/// @param[in] client Client
+/// @param[in] text Unsent rest of the status line
+/// @param[in] size Size of the rest
+/// @return Number of bytes sent, -1 if an error occurred (errno is set)
+static ssize_t send_text(struct Client* client, char const* text, size_t size) {
+    if (!client->pass_input_fd) {
+        return send(client->fd, text, size, 0);
+    }
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(sizeof(int))];
+    } control = {0};
+    struct iovec iov = {.iov_base = (void*) text, .iov_len = size};
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.data,
+        .msg_controllen = sizeof(control.data)
+    };
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &client->input_fd, sizeof(int));
+
+    ssize_t sent = sendmsg(client->fd, &message, 0);
+    if (sent > 0) {
+        // The descriptor goes with the first byte
+        client->pass_input_fd = false;
+    }
+    return sent;
+}
+
+/// @brief Sends as much of the pending reply as the socket accepts without blocking
+/// @param[in] client Client
+/// @param[in] buffer Buffer of SEND_BUFFER_SIZE bytes
+/// @return FLUSH_DONE if the reply has been sent completely, FLUSH_PENDING if the socket is full,
+/// FLUSH_ERROR if the connection should be closed
+static enum flush_result flush_reply(struct Client* client, char* buffer) {
+    while (reply_pending(client)) {
+        struct ReplyPart const* part = &client->parts[client->current_part];
+        ssize_t sent;
+        if (client->text_sent < part->text_size) {
+            sent = send_text(client, part->text + client->text_sent, part->text_size - client->text_sent);
+        } else if (client->data_sent < part->data_size) {
+            uint64_t left = part->data_size - client->data_sent;
+            size_t chunk = left < SEND_BUFFER_SIZE ? (size_t) left : SEND_BUFFER_SIZE;
+            ssize_t got = pread(client->input_fd, buffer, chunk, (off_t) (part->data_offset + client->data_sent));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            // The size has already been announced, so the only way to report a failure is to drop the connection
+            if (got <= 0) {
+                return FLUSH_ERROR;
+            }
+            sent = send(client->fd, buffer, (size_t) got, 0);
+        } else {
+            client->current_part++;
+            client->text_sent = 0;
+            client->data_sent = 0;
+            continue;
+        }
+
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? FLUSH_PENDING : FLUSH_ERROR;
+        }
+        client->last_progress = monotonic_ms();
+        if (client->text_sent < part->text_size) {
+            client->text_sent += (size_t) sent;
+        } else {
+            client->data_sent += (uint64_t) sent;
+        }
+    }
+    reply_reset(client);
+    return client->close_after_reply ? FLUSH_ERROR : FLUSH_DONE;
+}
+
+/// @brief Sends the pending reply and serves the buffered requests until the socket is full
+/// @param[in] client Client
+/// @param[in] cache File cache
+/// @param[in] buffer Buffer of SEND_BUFFER_SIZE bytes
+/// @return True if the client stays connected, false if the connection should be closed
+static bool serve_client(struct Client* client, struct FileCache* cache, char* buffer) {
+    while (true) {
+        enum flush_result result = flush_reply(client, buffer);
+        if (result != FLUSH_DONE) {
+            return result == FLUSH_PENDING;
+        }
+
+        char* end = memchr(client->request, '\n', client->used);
+        if (!end) {
+            if (client->used == REQUEST_MAX_SIZE) {
+                reply_error(client, "Request is too long.");
+                client->close_after_reply = true;
+                continue;
+            }
+            return true;
+        }
+        char line[REQUEST_MAX_SIZE];
+        size_t line_size = (size_t) (end - client->request);
+        memcpy(line, client->request, line_size);
+        line[line_size] = '\0';
+        client->used -= line_size + 1;
+        memmove(client->request, end + 1, client->used);
+
+        start_request(client, cache, line);
+    }
+}
+
+/// @brief Reads available data from the client and serves the complete requests
+/// @param[in] client Client without a pending reply
+/// @param[in] cache File cache
+/// @param[in] buffer Buffer of SEND_BUFFER_SIZE bytes
+/// @return True if the client stays connected, false if the connection should be closed
+static bool read_client(struct Client* client, struct FileCache* cache, char* buffer) {
+    ssize_t got = recv(client->fd, client->request + client->used, REQUEST_MAX_SIZE - client->used, 0);
+    if (got < 0) {
+        return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (got == 0) {
+        return false;
+    }
+    client->used += (size_t) got;
+    client->last_progress = monotonic_ms();
+    return serve_client(client, cache, buffer);
+}
+
+/// @brief Closes the client connection
+/// @param[in] client Client
+static void close_client(struct Client* client) {
+    reply_reset(client);
+    close(client->fd);
+}
+
+/// @brief Checks that the peer runs as the same user as the server.
+/// The file mode of the socket already restricts access, this also covers a socket
+/// reached through a directory with looser permissions or a filesystem ignoring the mode
+/// @param[in] fd Client socket
+/// @return True if the peer is allowed to send requests
+static bool peer_allowed(int fd) {
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t size = sizeof(cred);
+    return !getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) && cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return !getpeereid(fd, &uid, &gid) && uid == geteuid();
+#endif
+}
+
+/// @brief Accepts a new client from the server user and makes its socket non-blocking
+/// @param[in] listen_fd Listening socket
+/// @param[in] cache File cache, an entry is evicted if there are no free descriptors
+/// @param[out] client Client to initialize
+/// @return True if a client has been accepted
+static bool accept_client(int listen_fd, struct FileCache* cache, struct Client* client) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        if ((errno == EMFILE || errno == ENFILE) && cache->count) {
+            // Free a descriptor, the pending connection is accepted on the next iteration
+            evict_lru(cache);
+        }
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL);
+    if (!peer_allowed(fd) || flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK)) {
+        close(fd);
+        return false;
+    }
+    client->fd = fd;
+    client->used = 0;
+    client->last_progress = monotonic_ms();
+    client->input_fd = -1;
+    client->close_after_reply = false;
+    reply_reset(client);
+    return true;
+}
+
+/// @brief Creates the listening socket
+/// @param[in] socket_path Path of the socket
+/// @return Socket descriptor, -1 if an error occurred
+static int listen_socket(char const* socket_path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        print_error("Socket path is too long.");
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        print_error("Couldn't create the socket.");
+        return -1;
+    }
+    // Only a stale socket of a previous run may be replaced, never a regular file
+    struct stat st;
+    if (!lstat(socket_path, &st)) {
+        if (!S_ISSOCK(st.st_mode)) {
+            print_error("Socket path exists and is not a socket.");
+            close(fd);
+            return -1;
+        }
+        unlink(socket_path);
+    }
+    // Only the server user may connect. The umask makes bind() create the socket private
+    // already, so there is no window in which others could connect before the chmod()
+    mode_t old_umask = umask(S_IRWXG | S_IRWXO);
+    int bound = bind(fd, (struct sockaddr*) &address, sizeof(address));
+    umask(old_umask);
+    if (bound || chmod(socket_path, S_IRUSR | S_IWUSR) || listen(fd, SOMAXCONN)) {
+        print_error("Couldn't listen on the socket.");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// @brief Computes the poll timeout until the earliest client deadline
+/// @param[in] clients Connected clients
+/// @param[in] clients_number Number of connected clients
+/// @return Timeout in milliseconds, -1 if there are no clients
+static int poll_timeout(struct Client const* clients, size_t clients_number) {
+    if (!clients_number) {
+        return -1;
+    }
+    uint64_t oldest = clients[0].last_progress;
+    for (size_t i = 1; i < clients_number; i++) {
+        if (clients[i].last_progress < oldest) {
+            oldest = clients[i].last_progress;
+        }
+    }
+    uint64_t now = monotonic_ms();
+    return oldest + CLIENT_TIMEOUT_MS > now ? (int) (oldest + CLIENT_TIMEOUT_MS - now) : 0;
+}
+
+/// @brief Serves requests on the socket until an unrecoverable error occurs
+/// @param[in] socket_path Path of the Unix domain socket. An existing socket at this path is replaced,
+/// any other existing file makes the server fail
+/// @param[in] cache_size Maximal number of files kept open
+/// @return Program status (SERVER_ERROR), the function doesn't return on success
+int serve(char const* socket_path, size_t cache_size) {
+    // Clients that disconnect in the middle of a reply shouldn't kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    struct FileCache cache;
+    bool cache_created = cache_init(&cache, limit_cache_size(cache_size));
+    struct Client* clients = malloc(sizeof(struct Client) * MAX_CLIENTS);
+    char* buffer = malloc(SEND_BUFFER_SIZE);
+    int listen_fd = -1;
+    if (!cache_created || !clients || !buffer) {
+        print_error("Not enough free memory to start the server.");
+    } else {
+        listen_fd = listen_socket(socket_path);
+    }
+
+    // pollfds[0] is the listening socket, pollfds[i + 1] belongs to clients[i]
+    struct pollfd pollfds[MAX_CLIENTS + 1];
+    size_t clients_number = 0;
+    while (listen_fd >= 0) {
+        pollfds[0] = (struct pollfd) {.fd = listen_fd, .events = clients_number < MAX_CLIENTS ? POLLIN : 0};
+        for (size_t i = 0; i < clients_number; i++) {
+            short events = reply_pending(&clients[i]) ? POLLOUT : POLLIN;
+            pollfds[i + 1] = (struct pollfd) {.fd = clients[i].fd, .events = events};
+        }
+        if (poll(pollfds, clients_number + 1, poll_timeout(clients, clients_number)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            print_error("Waiting for requests failed.");
+            break;
+        }
+
+        // Walk backwards, so removing a client by moving the last one in its place is safe
+        uint64_t now = monotonic_ms();
+        for (size_t i = clients_number; i-- > 0;) {
+            bool keep = true;
+            if (pollfds[i + 1].revents) {
+                keep = reply_pending(&clients[i])
+                    ? serve_client(&clients[i], &cache, buffer)
+                    : read_client(&clients[i], &cache, buffer);
+            }
+            // Neither reading nor sending anything for too long
+            if (clients[i].last_progress + CLIENT_TIMEOUT_MS <= now) {
+                keep = false;
+            }
+            if (!keep) {
+                close_client(&clients[i]);
+                clients[i] = clients[--clients_number];
+            }
+        }
+        if ((pollfds[0].revents & POLLIN) && accept_client(listen_fd, &cache, &clients[clients_number])) {
+            clients_number++;
+        }
+    }
+
+    for (size_t i = 0; i < clients_number; i++) {
+        close_client(&clients[i]);
+    }
+    if (cache_created) {
+        cache_destroy(&cache);
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    free(clients);
+    free(buffer);
+    return SERVER_ERROR;
+}
+
+#else
+
+/// @brief Stub for platforms without Unix domain sockets
+/// @return SERVER_ERROR
+int serve(char const* socket_path, size_t cache_size) {
+    (void) socket_path; (void) cache_size;
+    print_error("Server mode is not supported on this platform.");
+    return SERVER_ERROR;
+}
+
+#endif
@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "io.h"
+
+#define REPLY_TIMEOUT_MS 5000
+#define PATH_SIZE 4096
+#define MAX_DATA_SIZE (64 * 1024)
+// Number of client slots of the server
+#define SERVER_MAX_CLIENTS 64
+
+// Sections of tests/<dir>/input.exe, all the fixtures share the same input
+static const struct {
+  const char *name;
+  const char *dir;
+} sections[] = {{".data", "1"}, {".text", "2"}, {".reloc", "3"}};
+
+static const char *extractor;
+static const char *tests_dir;
+static const char *stats_tests_dir;
+
+static char temp_dir[] = "/tmp/section-server-XXXXXX";
+static char socket_path[PATH_SIZE];
+static char input_path[PATH_SIZE];
+static pid_t server = -1;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static size_t read_file(const char *path, char *buffer, size_t size) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    fatal("Can't open %s\n", path);
+  const size_t read = fread(buffer, 1, size, f);
+  fclose(f);
+  return read;
+}
+
+static void write_file(const char *path, const char *buffer, size_t size) {
+  // Overwrite in place: the inode and the size stay the same, only the mtime tells the change
+  FILE *f = fopen(path, "r+b");
+  if (!f)
+    f = fopen(path, "wb");
+  if (!f || fwrite(buffer, 1, size, f) != size)
+    fatal("Can't write %s\n", path);
+  fclose(f);
+}
+
+static pid_t start_server(const char *path, int *status) {
+  const pid_t pid = fork();
+  if (pid < 0)
+    fatal("fork failed\n");
+  if (pid == 0) {
+    execl(extractor, extractor, "--serve", path, (char *)NULL);
+    _exit(127);
+  }
+  if (status)
+    waitpid(pid, status, 0);
+  return pid;
+}
+
+static void stop_server(void) {
+  if (server > 0) {
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    server = -1;
+  }
+}
+
+// Returns -1 on failure rather than exiting, so it's safe in forked children
+static int try_connect_server(void) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+  for (int attempt = 0; attempt < 500; attempt++) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      return -1;
+    if (!connect(fd, (struct sockaddr *)&address, sizeof(address)))
+      return fd;
+    close(fd);
+    nanosleep(&(struct timespec){.tv_nsec = 10 * 1000 * 1000}, NULL);
+  }
+  return -1;
+}
+
+static int connect_server(void) {
+  const int fd = try_connect_server();
+  if (fd < 0)
+    fatal("Can't connect to the server at %s\n", socket_path);
+  return fd;
+}
+
+static bool wait_readable(int fd) {
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  return poll(&pfd, 1, REPLY_TIMEOUT_MS) == 1;
+}
+
+static void send_request(int fd, const char *request) {
+  const size_t size = strlen(request);
+  if (send(fd, request, size, 0) != (ssize_t)size)
+    fatal("Can't send a request\n");
+}
+
+// Reads a status line byte by byte, so the section data following it stays in the socket
+static bool read_line(int fd, char *line, size_t size) {
+  for (size_t i = 0; i + 1 < size; i++) {
+    if (!wait_readable(fd) || recv(fd, &line[i], 1, 0) != 1)
+      return false;
+    if (line[i] == '\n') {
+      line[i + 1] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool read_exact(int fd, char *buffer, size_t size) {
+  while (size) {
+    if (!wait_readable(fd))
+      return false;
+    const ssize_t got = recv(fd, buffer, size, 0);
+    if (got <= 0)
+      return false;
+    buffer += got;
+    size -= (size_t)got;
+  }
+  return true;
+}
+
+// Reads an "OK <size>" reply and compares its data with the file
+static bool read_section_reply(int fd, const char *expected_path) {
+  static char expected[MAX_DATA_SIZE];
+  static char data[MAX_DATA_SIZE];
+  const size_t expected_size = read_file(expected_path, expected, sizeof(expected));
+
+  char line[128];
+  uint64_t size;
+  if (!read_line(fd, line, sizeof(line)) || sscanf(line, "OK %" SCNu64, &size) != 1 ||
+      size != expected_size)
+    return false;
+  return read_exact(fd, data, size) && !memcmp(data, expected, size);
+}
+
+static void test_get_sections(void) {
+  const int fd = connect_server();
+  char request[PATH_SIZE * 2];
+  int used = snprintf(request, sizeof(request), "GET\t%s", input_path);
+  for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++)
+    used += snprintf(request + used, sizeof(request) - used, "\t%s", sections[i].name);
+  snprintf(request + used, sizeof(request) - used, "\n");
+  send_request(fd, request);
+
+  for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+    char expected_path[PATH_SIZE];
+    snprintf(expected_path, sizeof(expected_path), "%s/%s/output_expected.bin", tests_dir,
+             sections[i].dir);
+    check(read_section_reply(fd, expected_path), "GET of several sections");
+  }
+  close(fd);
+}
+
+static void test_unknown_section(void) {
+  const int fd = connect_server();
+  char request[PATH_SIZE * 2];
+  snprintf(request, sizeof(request), "GET\t%s\t.nope\n", input_path);
+  send_request(fd, request);
+  char line[128];
+  check(read_line(fd, line, sizeof(line)) && !strncmp(line, "ERR ", 4),
+        "GET of an unknown section");
+
+  // The connection stays usable after an error
+  snprintf(request, sizeof(request), "GET\t%s\t.data\n", input_path);
+  send_request(fd, request);
+  char expected_path[PATH_SIZE];
+  snprintf(expected_path, sizeof(expected_path), "%s/1/output_expected.bin", tests_dir);
+  check(read_section_reply(fd, expected_path), "GET after an error");
+  close(fd);
+}
+
+static void test_fd_passing(void) {
+  const int fd = connect_server();
+  char request[PATH_SIZE * 2];
+  snprintf(request, sizeof(request), "FD\t%s\t.text\n", input_path);
+  send_request(fd, request);
+
+  char line[128] = {0};
+  union {
+    struct cmsghdr header;
+    char data[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct iovec iov = {.iov_base = line, .iov_len = sizeof(line) - 1};
+  struct msghdr message = {.msg_iov = &iov,
+                           .msg_iovlen = 1,
+                           .msg_control = control.data,
+                           .msg_controllen = sizeof(control.data)};
+  if (!wait_readable(fd) || recvmsg(fd, &message, 0) <= 0) {
+    check(false, "FD reply");
+    close(fd);
+    return;
+  }
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+  int file_fd = -1;
+  if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    memcpy(&file_fd, CMSG_DATA(cmsg), sizeof(int));
+  uint64_t offset, size;
+  const bool parsed = sscanf(line, "OK %" SCNu64 " %" SCNu64, &offset, &size) == 2;
+  check(file_fd >= 0, "FD reply carries a descriptor");
+  check(parsed, "FD reply status");
+
+  if (file_fd >= 0 && parsed && size <= MAX_DATA_SIZE) {
+    static char expected[MAX_DATA_SIZE];
+    static char data[MAX_DATA_SIZE];
+    char expected_path[PATH_SIZE];
+    snprintf(expected_path, sizeof(expected_path), "%s/2/output_expected.bin", tests_dir);
+    const size_t expected_size = read_file(expected_path, expected, sizeof(expected));
+    check(size == expected_size &&
+              pread(file_fd, data, size, (off_t)offset) == (ssize_t)size &&
+              !memcmp(data, expected, size),
+          "section data read through the passed descriptor");
+  }
+  if (file_fd >= 0)
+    close(file_fd);
+  close(fd);
+}
+
+static void test_reload(void) {
+  // stats-tests/2 has the same size, but its .data has no raw data
+  static char changed[MAX_DATA_SIZE];
+  char changed_path[PATH_SIZE];
+  snprintf(changed_path, sizeof(changed_path), "%s/2/input.exe", stats_tests_dir);
+  const size_t changed_size = read_file(changed_path, changed, sizeof(changed));
+
+  struct stat before;
+  if (stat(input_path, &before))
+    fatal("Can't stat %s\n", input_path);
+  write_file(input_path, changed, changed_size);
+  // Coarse filesystem timestamps may not move within one tick, so make the mtime differ
+  // by exactly one nanosecond
+  struct timespec times[2] = {before.st_atim, before.st_mtim};
+  if (++times[1].tv_nsec == 1000000000) {
+    times[1].tv_sec++;
+    times[1].tv_nsec = 0;
+  }
+  if (utimensat(AT_FDCWD, input_path, times, 0))
+    fatal("Can't set the mtime of %s\n", input_path);
+
+  const int fd = connect_server();
+  char request[PATH_SIZE * 2];
+  snprintf(request, sizeof(request), "GET\t%s\t.data\n", input_path);
+  send_request(fd, request);
+  char line[128];
+  check(read_line(fd, line, sizeof(line)) && !strcmp(line, "OK 0\n"),
+        "the file is reloaded after a change");
+  close(fd);
+}
+
+static void test_stalled_client(void) {
+  // This client keeps requesting and never reads, until its socket buffers are full
+  const int stalled = connect_server();
+  fcntl(stalled, F_SETFL, fcntl(stalled, F_GETFL) | O_NONBLOCK);
+  char request[PATH_SIZE * 2];
+  snprintf(request, sizeof(request), "GET\t%s\t.text\n", input_path);
+  const size_t size = strlen(request);
+  for (int i = 0; i < 100000; i++) {
+    if (send(stalled, request, size, 0) < 0)
+      break;
+  }
+
+  const int fd = connect_server();
+  snprintf(request, sizeof(request), "GET\t%s\t.nope\n", input_path);
+  send_request(fd, request);
+  char line[128];
+  check(read_line(fd, line, sizeof(line)) && !strncmp(line, "ERR ", 4),
+        "a stalled client doesn't block the others");
+  close(fd);
+  close(stalled);
+}
+
+static void test_silent_clients_dropped(void) {
+  // More silent connections than the server has slots: without a timeout they'd hold all of them
+  int silent[SERVER_MAX_CLIENTS + 4];
+  for (size_t i = 0; i < sizeof(silent) / sizeof(silent[0]); i++)
+    silent[i] = connect_server();
+
+  const int fd = connect_server();
+  char request[PATH_SIZE * 2];
+  snprintf(request, sizeof(request), "GET\t%s\t.nope\n", input_path);
+  send_request(fd, request);
+  char line[128];
+  check(read_line(fd, line, sizeof(line)) && !strncmp(line, "ERR ", 4),
+        "silent clients don't lock the others out");
+
+  // The server has closed the silent connections
+  char byte;
+  check(wait_readable(silent[0]) && recv(silent[0], &byte, 1, 0) == 0,
+        "a silent client is disconnected");
+  for (size_t i = 0; i < sizeof(silent) / sizeof(silent[0]); i++)
+    close(silent[i]);
+  close(fd);
+}
+
+static void test_access(void) {
+  struct stat st;
+  check(!stat(socket_path, &st) && (st.st_mode & 0777) == 0600, "the socket is private to the server user");
+
+  // Connecting as another user needs root, which may change the user of a child.
+  // The socket and its directory are opened up, so only the peer check keeps the child out
+  if (geteuid() != 0)
+    return;
+  if (chmod(temp_dir, 0711) || chmod(socket_path, 0666))
+    fatal("Can't open up the socket\n");
+  const pid_t pid = fork();
+  if (pid < 0)
+    fatal("fork failed\n");
+  if (pid == 0) {
+    if (setuid(65534))
+      _exit(2);
+    const int fd = try_connect_server();
+    if (fd < 0)
+      _exit(3);
+    char request[PATH_SIZE * 2];
+    snprintf(request, sizeof(request), "GET\t%s\t.data\n", input_path);
+    send(fd, request, strlen(request), 0);
+    char byte;
+    _exit(wait_readable(fd) && recv(fd, &byte, 1, 0) <= 0 ? 0 : 1);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "a client of another user is disconnected");
+  chmod(socket_path, 0600);
+  chmod(temp_dir, 0700);
+}
+
+static void test_not_a_socket(void) {
+  char path[PATH_SIZE];
+  snprintf(path, sizeof(path), "%s/regular", temp_dir);
+  const char content[] = "not a socket";
+  write_file(path, content, sizeof(content));
+
+  int status;
+  start_server(path, &status);
+  check(WIFEXITED(status) && WEXITSTATUS(status) != 0,
+        "the server refuses to replace a regular file");
+  char actual[sizeof(content)] = {0};
+  check(read_file(path, actual, sizeof(actual)) == sizeof(content) && !memcmp(actual, content, sizeof(content)),
+        "the regular file is left intact");
+  unlink(path);
+}
+
+static void cleanup(void) {
+  stop_server();
+  unlink(socket_path);
+  unlink(input_path);
+  rmdir(temp_dir);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: ./server-tester section_extractor tests_dir stats_tests_dir\n");
+    return -1;
+  }
+  extractor = argv[1];
+  tests_dir = argv[2];
+  stats_tests_dir = argv[3];
+
+  // Socket paths are limited to about a hundred bytes, the build directory may be deeper
+  if (!mkdtemp(temp_dir))
+    fatal("Can't create a temporary directory\n");
+  snprintf(socket_path, sizeof(socket_path), "%s/server.sock", temp_dir);
+  snprintf(input_path, sizeof(input_path), "%s/input.exe", temp_dir);
+  atexit(cleanup);
+
+  static char input[MAX_DATA_SIZE];
+  char source_path[PATH_SIZE];
+  snprintf(source_path, sizeof(source_path), "%s/1/input.exe", tests_dir);
+  write_file(input_path, input, read_file(source_path, input, sizeof(input)));
+
+  signal(SIGPIPE, SIG_IGN);
+  server = start_server(socket_path, NULL);
+
+  test_get_sections();
+  test_unknown_section();
+  test_fd_passing();
+  test_stalled_client();
+  test_silent_clients_dropped();
+  test_access();
+  test_reload();
+  test_not_a_socket();
+
+  if (failures) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,32 @@
+# CMP0007: list command no longer ignores empty elements.
+if(POLICY CMP0007)
+    cmake_policy(SET CMP0007 NEW)
+endif()
+
+function(exec_check)
+    execute_process(COMMAND ${ARGV}
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE  err
+        RESULT_VARIABLE result)
+    if(result)
+        string(REPLACE "/" ";" name_components ${ARGV0})
+        list(GET name_components -1 name)
+        if(NOT out)
+            set(out "<empty>")
+        endif()
+        if(NOT err)
+            set(err "<empty>")
+        endif()
+        message(FATAL_ERROR "\nError running \"${name}\"\n*** Output: ***\n${out}\n*** Error: ***\n${err}\n")
+    endif()
+endfunction()
+
+file(REMOVE ${TEST_DIR}/output.txt)
+execute_process(COMMAND ${SECTION_EXTRACTOR} --stats ${TEST_DIR}/input.exe
+    OUTPUT_FILE ${TEST_DIR}/output.txt
+    ERROR_VARIABLE err
+    RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "\nError running \"section-extractor --stats\"\n*** Error: ***\n${err}\n")
+endif()
+exec_check(${FILE_MATCHER} ${TEST_DIR}/output.txt ${TEST_DIR}/output_expected.txt)
@@ -21,7 +21,28 @@ function(exec_check)
     endif()
 endfunction()
 
+if(NOT OUTPUT_NAME)
+    set(OUTPUT_NAME output.bin)
+endif()
+if(EXTRACTOR_JOBS)
+    set(JOBS_ARGS --jobs ${EXTRACTOR_JOBS})
+endif()
+
 file(STRINGS ${TEST_DIR}/section SECTION_NAME)
-file(REMOVE ${TEST_DIR}/output.bin)
-exec_check(${SECTION_EXTRACTOR} ${TEST_DIR}/input.exe ${SECTION_NAME} ${TEST_DIR}/output.bin)
-exec_check(${FILE_MATCHER} ${TEST_DIR}/output.bin ${TEST_DIR}/output_expected.bin)
+
+if(PIPE_OUTPUT)
+    # The extractor writes to a pipe read by the matcher, which has no offsets to write at
+    execute_process(
+        COMMAND ${SECTION_EXTRACTOR} ${JOBS_ARGS} ${TEST_DIR}/input.exe ${SECTION_NAME} /dev/stdout
+        COMMAND ${FILE_MATCHER} /dev/stdin ${TEST_DIR}/output_expected.bin
+        ERROR_VARIABLE err
+        RESULTS_VARIABLE results)
+    if(NOT results STREQUAL "0;0")
+        message(FATAL_ERROR "\nError running the pipeline, results: ${results}\n*** Error: ***\n${err}\n")
+    endif()
+    return()
+endif()
+
+file(REMOVE ${TEST_DIR}/${OUTPUT_NAME})
+exec_check(${SECTION_EXTRACTOR} ${JOBS_ARGS} ${TEST_DIR}/input.exe ${SECTION_NAME} ${TEST_DIR}/${OUTPUT_NAME})
+exec_check(${FILE_MATCHER} ${TEST_DIR}/${OUTPUT_NAME} ${TEST_DIR}/output_expected.bin)
@@ -0,0 +1,69 @@
+//
+// Host stand-in for the part of the simulator's hal.h used by the labs.
+// GPIO calls advance a virtual clock, so handler durations are deterministic
+//
+
+#pragma once
+
+#include <cstdint>
+
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+#define GPIO_PIN_3 (1U << 3)
+#define GPIO_PIN_4 (1U << 4)
+#define GPIO_PIN_5 (1U << 5)
+#define GPIO_PIN_6 (1U << 6)
+#define GPIO_PIN_8 (1U << 8)
+#define GPIO_PIN_9 (1U << 9)
+#define GPIO_PIN_10 (1U << 10)
+#define GPIO_PIN_11 (1U << 11)
+#define GPIO_PIN_12 (1U << 12)
+
+struct host_gpio {
+    uint32_t odr;
+    uint32_t idr;
+};
+
+inline host_gpio host_gpiod, host_gpioe;
+#define GPIOD (&host_gpiod)
+#define GPIOE (&host_gpioe)
+
+// virtual time, in clock units, and the cost of each HAL call
+inline uint32_t host_clock = 0;
+const uint32_t HOST_READ_PIN_COST = 5;
+const uint32_t HOST_WRITE_PIN_COST = 10;
+
+inline uint32_t host_virtual_clock() {
+    return host_clock;
+}
+
+inline GPIO_PinState HAL_GPIO_ReadPin(host_gpio *port, uint32_t pin) {
+    host_clock += HOST_READ_PIN_COST;
+    return port->idr & pin ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+inline void HAL_GPIO_WritePin(host_gpio *port, uint32_t pin, GPIO_PinState value) {
+    host_clock += HOST_WRITE_PIN_COST;
+    port->odr = value == GPIO_PIN_SET ? port->odr | pin : port->odr & ~pin;
+}
+
+inline uint32_t TIM6_ARR, TIM6_DIER, TIM6_PSC, TIM6_CR1;
+inline uint32_t TIM7_ARR, TIM7_DIER, TIM7_PSC, TIM7_CR1;
+
+#define TIM_DIER_UIE (1U << 0)
+#define TIM_CR1_CEN (1U << 0)
+
+#define WRITE_REG(REG, VAL) ((REG) = (VAL))
+
+inline void (*host_tim6_handler)() = nullptr;
+inline void (*host_tim7_handler)() = nullptr;
+
+inline void registerTIM6_IRQHandler(void (*handler)()) {
+    host_tim6_handler = handler;
+}
+
+inline void registerTIM7_IRQHandler(void (*handler)()) {
+    host_tim7_handler = handler;
+}
+
+inline void __enable_irq() {}
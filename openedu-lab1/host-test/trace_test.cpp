@@ -0,0 +1,82 @@
+//
+// Host test of the lab2 ISR trace against a virtual clock.
+// Build and run from openedu-lab1/:
+//   c++ -std=c++17 -Wall -Ihost-test host-test/trace_test.cpp -o trace_test && ./trace_test
+//
+
+#include "../lab2.cpp"
+
+#include <cstdio>
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// fires the handler `interval` clock units after the previous one
+void fire(void (*handler)(), uint32_t interval) {
+    host_clock += interval;
+    handler();
+}
+
+int main() {
+    trace_set_clock(host_virtual_clock);
+    umain();
+
+    // 8 pin writes per frame, 4 pin reads per switch poll
+    const uint32_t TIM6_DURATION = 8 * HOST_WRITE_PIN_COST;
+    const uint32_t TIM7_DURATION = 4 * HOST_READ_PIN_COST;
+
+    for (int i = 0; i < 10; i++) {
+        fire(host_tim6_handler, 1000);
+        fire(host_tim7_handler, 100);
+    }
+    // one late frame: the interval grows by 30
+    fire(host_tim6_handler, 1030);
+
+    irq_stats tim6 = get_irq_stats(IRQ_TIM6);
+    irq_stats tim7 = get_irq_stats(IRQ_TIM7);
+    check(tim6.count == 11 && tim7.count == 10, "handler counts");
+    check(tim6.max_duration == TIM6_DURATION, "TIM6 duration");
+    check(tim7.max_duration == TIM7_DURATION, "TIM7 duration");
+    check(tim6.max_jitter == 30, "TIM6 jitter");
+    check(tim7.max_jitter == 0, "TIM7 jitter");
+    check(trace_within_budget(IRQ_TIM6, TIM6_DURATION, 30), "TIM6 within its budget");
+    check(!trace_within_budget(IRQ_TIM6, TIM6_DURATION - 1, 30), "TIM6 over a smaller duration budget");
+    check(!trace_within_budget(IRQ_TIM6, TIM6_DURATION, 29), "TIM6 over a smaller jitter budget");
+
+    trace_event events[TRACE_SIZE];
+    uint32_t tail = 0;
+    int n = trace_read(events, TRACE_SIZE, &tail);
+    check(n == 21 && tail == 21, "all events read");
+    bool ordered = true;
+    for (int i = 0; i < n; i++) {
+        ordered = ordered && events[i].irq == (i % 2 ? IRQ_TIM7 : IRQ_TIM6) && events[i].exit > events[i].enter;
+        ordered = ordered && (i == 0 || events[i].enter > events[i - 1].exit);
+    }
+    check(ordered, "events in order");
+    check(trace_read(events, TRACE_SIZE, &tail) == 0, "nothing new to read");
+
+    // the writers run ahead of the reader: only the last TRACE_SIZE events are kept
+    for (int i = 0; i < TRACE_SIZE + 10; i++) {
+        fire(host_tim7_handler, 100);
+    }
+    n = trace_read(events, TRACE_SIZE, &tail);
+    check(n == TRACE_SIZE && tail == 21 + TRACE_SIZE + 10, "overwritten events dropped");
+
+    // a switch change reprograms the period once
+    host_gpioe.idr = GPIO_PIN_12;
+    fire(host_tim7_handler, 100);
+    check(TIM6_ARR == periods[1] && sw_cur == 1, "period follows the switches");
+
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("ok\n");
+    return 0;
+}
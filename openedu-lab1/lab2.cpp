@@ -4,6 +4,30 @@
 
 #include "hal.h"
 
+#include <atomic>
+#include <cstdint>
+
+// DMA playback is hardware-only: it needs the STM32F4 CMSIS device definitions.
+// The simulator's hal.h only models TIM6/TIM7 and the GPIO ports, so there the
+// frames are still set from the TIM6 interrupt, and the DMA path has not been
+// run on a board yet.
+// DMA1 can't reach the AHB1 GPIO ports, so the frames are clocked by TIM8,
+// whose update request goes to DMA2
+#if defined(DMA2_Stream1) && defined(TIM8) && defined(RCC_AHB1ENR_DMA2EN)
+#define ANIMATION_DMA
+#endif
+
+#ifdef ANIMATION_DMA
+#define FRAME_TIMER_ARR (TIM8->ARR)
+#else
+#define FRAME_TIMER_ARR TIM6_ARR
+#endif
+
+// ARR preload enable bit of TIMx_CR1, in case hal.h doesn't name it
+#ifndef TIM_CR1_ARPE
+#define TIM_CR1_ARPE (1U << 7)
+#endif
+
 int lamps[8] = {GPIO_PIN_3, GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_6, GPIO_PIN_8, GPIO_PIN_9, GPIO_PIN_11, GPIO_PIN_12};
 int animation[8][8] = {{0, 0, 0, 1, 1, 0, 0, 0},
                        {0, 0, 1, 1, 1, 1, 0, 0},
@@ -18,7 +42,78 @@ const int TIME_DELTA = 50;
 unsigned int switches[] = {GPIO_PIN_4, GPIO_PIN_8, GPIO_PIN_10, GPIO_PIN_12};
 
 int sw_cur = 0;
+
+// frame timer period for every switch code
+const uint32_t periods[16] = {TIME_INIT, TIME_INIT + TIME_DELTA, TIME_INIT + TIME_DELTA * 2, TIME_INIT + TIME_DELTA * 3,
+                              TIME_INIT + TIME_DELTA * 4, TIME_INIT + TIME_DELTA * 5, TIME_INIT + TIME_DELTA * 6, TIME_INIT + TIME_DELTA * 7,
+                              TIME_INIT + TIME_DELTA * 8, TIME_INIT + TIME_DELTA * 9, TIME_INIT + TIME_DELTA * 10, TIME_INIT + TIME_DELTA * 11,
+                              TIME_INIT + TIME_DELTA * 12, TIME_INIT + TIME_DELTA * 13, TIME_INIT + TIME_DELTA * 14, TIME_INIT + TIME_DELTA * 15};
+
+#ifdef ANIMATION_DMA
+// BSRR words for each animation frame: low half sets the pins, high half resets them
+uint32_t frames[8];
+#else
 int state = 0;
+#endif
+
+// ISR trace: entry/exit timestamps in a lock-free ring buffer written only from
+// interrupts and drained with trace_read(). Timestamps come from trace_clock: the
+// DWT cycle counter on hardware (CMSIS builds). The simulator has no cycle counter,
+// so there nothing is recorded until a clock is set with trace_set_clock(), e.g.
+// the virtual clock of the host tests in host-test/
+struct trace_event {
+    int irq;
+    // trace clock units
+    uint32_t enter;
+    uint32_t exit;
+};
+
+// all times in trace clock units
+struct irq_stats {
+    uint32_t count;
+    uint32_t max_duration;
+    // largest change between two consecutive intervals of handler entries
+    uint32_t max_jitter;
+};
+
+const int TRACE_SIZE = 64;
+const int IRQ_TIM6 = 0;
+const int IRQ_TIM7 = 1;
+const int IRQ_COUNT = 2;
+
+// a ring buffer slot, guarded by its sequence number like a seqlock
+struct trace_slot {
+    // position of the event in the trace + 1, 0 while the slot is being written
+    std::atomic<uint32_t> seq;
+    std::atomic<int> irq;
+    std::atomic<uint32_t> enter;
+    std::atomic<uint32_t> exit;
+};
+
+// written only by the handler of its IRQ, which doesn't preempt itself
+struct irq_counters {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> max_duration;
+    std::atomic<uint32_t> max_jitter;
+    uint32_t last_enter;
+    uint32_t last_interval;
+};
+
+trace_slot trace[TRACE_SIZE];
+// total number of reserved slots, the next event goes to trace[trace_head % TRACE_SIZE]
+std::atomic<uint32_t> trace_head(0);
+irq_counters counters[IRQ_COUNT];
+
+#ifdef DWT
+uint32_t dwt_cycles() {
+    return READ_REG(DWT->CYCCNT);
+}
+
+uint32_t (*trace_clock)() = dwt_cycles;
+#else
+uint32_t (*trace_clock)() = nullptr;
+#endif
+bool trace_clock_injected = false;
 
 int match_sw_to_number() {
     int res = 0;
@@ -32,6 +127,142 @@ int match_sw_to_number() {
     return res;
 }
 
+// The frame timer runs with ARPE set, so the new period goes to the shadow register
+// and takes effect at the next update event without cutting the current frame
+void set_speed(int sw) {
+    if (sw == sw_cur) {
+        return;
+    }
+    sw_cur = sw;
+    WRITE_REG(FRAME_TIMER_ARR, periods[sw_cur]);
+}
+
+// must be called before trace_init()
+void trace_set_clock(uint32_t (*clock)()) {
+    trace_clock = clock;
+    trace_clock_injected = true;
+}
+
+void trace_init() {
+#ifdef DWT
+    if (trace_clock_injected) {
+        return;
+    }
+    SET_BIT(CoreDebug->DEMCR, CoreDebug_DEMCR_TRCENA_Msk);
+    WRITE_REG(DWT->CYCCNT, 0);
+    SET_BIT(DWT->CTRL, DWT_CTRL_CYCCNTENA_Msk);
+#endif
+}
+
+uint32_t trace_enter() {
+    return trace_clock ? trace_clock() : 0;
+}
+
+void update_max(std::atomic<uint32_t> &max, uint32_t value) {
+    if (value > max.load(std::memory_order_relaxed)) {
+        max.store(value, std::memory_order_relaxed);
+    }
+}
+
+// No critical section: TIM6 and TIM7 handlers may preempt each other, but each
+// one reserves its own slot and updates only its own counters
+void trace_record(int irq, uint32_t enter) {
+    if (!trace_clock) {
+        return;
+    }
+    uint32_t exit = trace_clock();
+    uint32_t pos = trace_head.fetch_add(1, std::memory_order_relaxed);
+
+    trace_slot &slot = trace[pos % TRACE_SIZE];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.irq.store(irq, std::memory_order_relaxed);
+    slot.enter.store(enter, std::memory_order_relaxed);
+    slot.exit.store(exit, std::memory_order_relaxed);
+    slot.seq.store(pos + 1, std::memory_order_release);
+
+    irq_counters &c = counters[irq];
+    uint32_t count = c.count.load(std::memory_order_relaxed);
+    if (count > 0) {
+        uint32_t interval = enter - c.last_enter;
+        if (count > 1) {
+            update_max(c.max_jitter, interval > c.last_interval ? interval - c.last_interval : c.last_interval - interval);
+        }
+        c.last_interval = interval;
+    }
+    c.last_enter = enter;
+    update_max(c.max_duration, exit - enter);
+    c.count.store(count + 1, std::memory_order_relaxed);
+}
+
+// Copies up to max events recorded since *tail to out and advances *tail.
+// Runs with interrupts enabled: events overwritten by the handlers before or
+// while being copied are dropped. Returns the number of events in out
+int trace_read(trace_event *out, int max, uint32_t *tail) {
+    uint32_t head = trace_head.load(std::memory_order_acquire);
+    if (head - *tail > (uint32_t) TRACE_SIZE) {
+        *tail = head - TRACE_SIZE;
+    }
+    int n = 0;
+    for (; *tail != head && n < max; (*tail)++) {
+        trace_slot &slot = trace[*tail % TRACE_SIZE];
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        out[n].irq = slot.irq.load(std::memory_order_relaxed);
+        out[n].enter = slot.enter.load(std::memory_order_relaxed);
+        out[n].exit = slot.exit.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq == *tail + 1 && slot.seq.load(std::memory_order_relaxed) == seq) {
+            n++;
+        }
+    }
+    return n;
+}
+
+irq_stats get_irq_stats(int irq) {
+    irq_counters &c = counters[irq];
+    irq_stats res;
+    res.count = c.count.load(std::memory_order_relaxed);
+    res.max_duration = c.max_duration.load(std::memory_order_relaxed);
+    res.max_jitter = c.max_jitter.load(std::memory_order_relaxed);
+    return res;
+}
+
+// Checks the worst cases seen so far, e.g. in tests against the simulator clock
+bool trace_within_budget(int irq, uint32_t max_duration, uint32_t max_jitter) {
+    irq_stats st = get_irq_stats(irq);
+    return st.max_duration <= max_duration && st.max_jitter <= max_jitter;
+}
+
+#ifdef ANIMATION_DMA
+uint32_t frame_to_bsrr(int state) {
+    uint32_t res = 0;
+    for (int i = 0; i < 8; i++) {
+        res |= animation[state][i] ? lamps[i] : (uint32_t) lamps[i] << 16;
+    }
+    return res;
+}
+
+void build_frames() {
+    for (int i = 0; i < 8; i++) {
+        frames[i] = frame_to_bsrr(i);
+    }
+}
+
+// TIM8 update request is routed to DMA2 stream 1, channel 7.
+// The stream runs in circular mode and copies one frame to GPIOD->BSRR per update event
+void start_animation_dma() {
+    CLEAR_BIT(DMA2_Stream1->CR, DMA_SxCR_EN);
+    while (READ_BIT(DMA2_Stream1->CR, DMA_SxCR_EN)) {}
+
+    WRITE_REG(DMA2_Stream1->PAR, (uint32_t) (uintptr_t) &GPIOD->BSRR);
+    WRITE_REG(DMA2_Stream1->M0AR, (uint32_t) (uintptr_t) frames);
+    WRITE_REG(DMA2_Stream1->NDTR, 8);
+    WRITE_REG(DMA2_Stream1->CR, DMA_SxCR_CHSEL_0 | DMA_SxCR_CHSEL_1 | DMA_SxCR_CHSEL_2 |
+                                DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+                                DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0);
+    SET_BIT(DMA2_Stream1->CR, DMA_SxCR_EN);
+}
+#else
 void set_animation_state(int state) {
     for (int i = 0; i < 8; i++) {
         HAL_GPIO_WritePin(GPIOD, lamps[i], animation[state][i] ? GPIO_PIN_SET : GPIO_PIN_RESET);
@@ -40,33 +271,58 @@ void set_animation_state(int state) {
 
 void TIM6_IRQ_Handler()
 {
+    uint32_t enter = trace_enter();
     set_animation_state(state);
     state = (state + 1) % 8;
+    trace_record(IRQ_TIM6, enter);
 }
+#endif
 
 void TIM7_IRQ_Handler()
 {
-    sw_cur = match_sw_to_number();
-    WRITE_REG(TIM6_ARR, TIME_INIT + TIME_DELTA * sw_cur);
+    uint32_t enter = trace_enter();
+    set_speed(match_sw_to_number());
+    trace_record(IRQ_TIM7, enter);
 }
 
 
 int umain() {
 
+#ifndef ANIMATION_DMA
     registerTIM6_IRQHandler(TIM6_IRQ_Handler);
+#endif
     registerTIM7_IRQHandler(TIM7_IRQ_Handler);
 
+    trace_init();
     __enable_irq();
 
-    WRITE_REG(TIM6_ARR, TIME_INIT);
+#ifdef ANIMATION_DMA
+    SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_DMA2EN);
+    SET_BIT(RCC->APB2ENR, RCC_APB2ENR_TIM8EN);
+    build_frames();
+    start_animation_dma();
+
+    // written before ARPE is set, so the value is loaded right away.
+    // No CPU interrupt for frames: the update event only triggers a DMA request
+    WRITE_REG(TIM8->ARR, periods[sw_cur]);
+    WRITE_REG(TIM8->DIER, TIM_DIER_UDE);
+    WRITE_REG(TIM8->PSC, 0);
+#else
+    // written before ARPE is set, so the value is loaded right away
+    WRITE_REG(TIM6_ARR, periods[sw_cur]);
     WRITE_REG(TIM6_DIER, TIM_DIER_UIE);
     WRITE_REG(TIM6_PSC, 0);
+#endif
     WRITE_REG(TIM7_ARR, 100);
     WRITE_REG(TIM7_DIER, TIM_DIER_UIE);
     WRITE_REG(TIM7_PSC, 0);
 
     // turn on timers
-    WRITE_REG(TIM6_CR1, TIM_CR1_CEN);
+#ifdef ANIMATION_DMA
+    WRITE_REG(TIM8->CR1, TIM_CR1_ARPE | TIM_CR1_CEN);
+#else
+    WRITE_REG(TIM6_CR1, TIM_CR1_ARPE | TIM_CR1_CEN);
+#endif
     WRITE_REG(TIM7_CR1, TIM_CR1_CEN);
 
     return 0;